@@ -20,18 +20,108 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <sys/socket.h>
 
-uint16_t in_cksum(uint16_t *p, size_t len)
+/*
+ * Internet checksum, RFC 1071.  The buffer is summed in native byte
+ * order, 32 bits at a time into a 64-bit accumulator, which cannot
+ * overflow for any buffer we can read from a socket.  The one's
+ * complement sum is byte order independent, so the result can be
+ * stored as-is in the header, no htons() needed.
+ */
+uint16_t in_cksum(const void *buf, size_t len)
+{
+	const uint8_t *p = buf;
+	uint64_t sum = 0;
+	uint32_t w32;
+	uint16_t w16;
+
+	while (len >= 4) {
+		memcpy(&w32, p, sizeof(w32));
+		sum += w32;
+		p   += 4;
+		len -= 4;
+	}
+
+	if (len >= 2) {
+		memcpy(&w16, p, sizeof(w16));
+		sum += w16;
+		p   += 2;
+		len -= 2;
+	}
+
+	if (len) {
+		w16 = 0;
+		memcpy(&w16, p, 1);
+		sum += w16;
+	}
+
+	while (sum >> 16)
+		sum = (sum & 0xffff) + (sum >> 16);
+
+	return (uint16_t)~sum;
+}
+
+/*
+ * Incremental checksum update, RFC 1624 eqn. 3: HC' = ~(~HC + ~m + m')
+ * All arguments are 16-bit words as stored in the packet.
+ */
+uint16_t in_cksum_update(uint16_t cksum, uint16_t old, uint16_t new)
+{
+	uint32_t sum;
+
+	sum  = (uint16_t)~cksum;
+	sum += (uint16_t)~old;
+	sum += new;
+	while (sum >> 16)
+		sum = (sum & 0xffff) + (sum >> 16);
+
+	return (uint16_t)~sum;
+}
+
+/* Monotonic time in milliseconds, for timers and deadlines */
+uint64_t now_ms(void)
 {
-	uint32_t sum = 0;
-	size_t i;
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/*
+ * Like read(), but also picks up the SO_RXQ_OVFL ancillary data, which
+ * is the total number of frames the kernel has dropped on this socket
+ * because the receive queue was full.  Left untouched if not present.
+ */
+ssize_t recv_ovfl(int sd, char *buf, size_t len, uint32_t *drops)
+{
+	union {
+		char           buf[CMSG_SPACE(sizeof(uint32_t))];
+		struct cmsghdr align;	/* Read as cmsghdr, see cmsg(3) */
+	} cbuf;
+	struct iovec iov = { buf, len };
+	struct msghdr msg;
+	struct cmsghdr *cmsg;
+	ssize_t num;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov        = &iov;
+	msg.msg_iovlen     = 1;
+	msg.msg_control    = cbuf.buf;
+	msg.msg_controllen = sizeof(cbuf.buf);
 
-	for (i = 0; i < len; i++)
-		sum += ntohs(p[i]);
+	num = recvmsg(sd, &msg, 0);
+	if (num < 0)
+		return -1;
 
-	sum = (sum % 0x10000) + (sum / 0x10000);
+	for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+		if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL)
+			memcpy(drops, CMSG_DATA(cmsg), sizeof(*drops));
+	}
 
-	return htons(((uint16_t)sum) ^ 0xffff);
+	return num;
 }
 
 void compose_addr6(struct sockaddr_in6 *sin, char *group)
@@ -0,0 +1,381 @@
+/* Protocol event stream for subscribers on a UNIX socket
+ *
+ * Copyright (c) 2017-2021  Joachim Wiberg <troglobit@gmail.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <config.h>
+#include <err.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "events.h"
+
+struct event {
+	struct timespec ts;
+	uint8_t         type;
+	uint8_t         af;
+	uint8_t         interval;
+	uint8_t         failed;
+	char            ifname[16];	/* IFNAMSIZ */
+};
+
+/*
+ * Each subscriber has its own read position in the ring.  A subscriber
+ * that falls more than EVENTS_RING events behind loses the oldest ones,
+ * which is reported to it with a "dropped" event.  Writes never block,
+ * what does not fit in the socket buffer is kept in buf until POLLOUT.
+ * New subscribers first get an "add" for every active interface, from
+ * iftab[], which is maintained also when nobody is listening.
+ */
+struct sub {
+	int      sd;
+	size_t   sync, nsync;	/* Position in iftab[] when catching up */
+	uint64_t tail;
+	uint64_t dropped;
+	size_t   len, off;
+	char     buf[256];	/* Fits a line with a fully escaped ifname */
+};
+
+static int          lsd = -1;
+static const char  *sock_path;
+static struct event ring[EVENTS_RING];
+static uint64_t     head;
+static struct sub   subs[EVENTS_SUBS];
+static int          nsubs;
+static struct event *iftab;
+static size_t       iflen, ifmax;
+
+static const char *evname[] = {
+	[EV_IFADD]     = "add",
+	[EV_IFDEL]     = "remove",
+	[EV_ANNOUNCE]  = "announce",
+	[EV_SOLICIT]   = "solicit",
+	[EV_TERMINATE] = "terminate",
+};
+
+/* Check for a live listener before taking over a socket path */
+static int sock_alive(struct sockaddr_un *sun)
+{
+	int sd, rc;
+
+	sd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (sd < 0)
+		return 0;
+
+	rc = connect(sd, (struct sockaddr *)sun, sizeof(*sun));
+	close(sd);
+
+	return rc == 0;
+}
+
+int events_init(const char *path)
+{
+	struct sockaddr_un sun;
+	int i;
+
+	for (i = 0; i < EVENTS_SUBS; i++)
+		subs[i].sd = -1;
+
+	memset(&sun, 0, sizeof(sun));
+	sun.sun_family = AF_UNIX;
+	snprintf(sun.sun_path, sizeof(sun.sun_path), "%s", path);
+
+	lsd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (lsd < 0)
+		goto fail;
+
+	if (sock_alive(&sun)) {
+		warnx("%s in use by another mrdisc, event stream not available", path);
+		close(lsd);
+		lsd = -1;
+		return -1;
+	}
+	if (errno == ECONNREFUSED)
+		unlink(path);	/* Stale, left behind by a crashed instance */
+
+	if (bind(lsd, (struct sockaddr *)&sun, sizeof(sun)) || listen(lsd, EVENTS_SUBS)) {
+		close(lsd);
+		lsd = -1;
+		goto fail;
+	}
+	sock_path = path;
+
+	return 0;
+fail:
+	warn("Cannot create %s, event stream not available", path);
+	return -1;
+}
+
+static void sub_close(struct sub *sub)
+{
+	close(sub->sd);
+	sub->sd = -1;
+	nsubs--;
+}
+
+static void event_set(struct event *ev, int type, int af, char *ifname, uint8_t interval, int failed)
+{
+	clock_gettime(CLOCK_REALTIME, &ev->ts);
+	ev->type     = type;
+	ev->af       = af;
+	ev->interval = interval;
+	ev->failed   = failed;
+	snprintf(ev->ifname, sizeof(ev->ifname), "%s", ifname);
+}
+
+/* Removed entries are only marked, to not upset subscribers in sync */
+static void iftab_update(int type, int af, char *ifname, uint8_t interval, int failed)
+{
+	size_t i;
+
+	if (type == EV_IFDEL) {
+		for (i = 0; i < iflen; i++) {
+			if (iftab[i].type == EV_IFADD && iftab[i].af == af &&
+			    !strncmp(iftab[i].ifname, ifname, sizeof(iftab[i].ifname) - 1))
+				iftab[i].type = EV_IFDEL;
+		}
+		return;
+	}
+
+	if (iflen == ifmax) {
+		ifmax = ifmax ? ifmax * 2 : 16;
+		iftab = realloc(iftab, ifmax * sizeof(*iftab));
+		if (!iftab)
+			err(1, "Failed allocating event interface table");
+	}
+	event_set(&iftab[iflen++], type, af, ifname, interval, failed);
+}
+
+void events_push(int type, int af, char *ifname, uint8_t interval, int failed)
+{
+	if (type == EV_IFADD || type == EV_IFDEL)
+		iftab_update(type, af, ifname, interval, failed);
+
+	/* Nobody listening, nothing to record */
+	if (!nsubs)
+		return;
+
+	event_set(&ring[head++ & (EVENTS_RING - 1)], type, af, ifname, interval, failed);
+}
+
+static int sub_pending(struct sub *sub)
+{
+	return sub->sync < sub->nsync || sub->tail != head;
+}
+
+/*
+ * Interface names may contain any character but '/', ':' and white
+ * space, so escape what JSON does not allow in a string.  In the worst
+ * case every character becomes a \u00XX sequence.
+ */
+static void json_escape(char *dst, size_t len, const char *src)
+{
+	size_t n = 0;
+
+	for (; *src && n + 7 <= len; src++) {
+		unsigned char c = *src;
+
+		if (c == '"' || c == '\\') {
+			dst[n++] = '\\';
+			dst[n++] = c;
+		} else if (c < 0x20 || c == 0x7f)
+			n += snprintf(&dst[n], len - n, "\\u%04x", c);
+		else
+			dst[n++] = c;
+	}
+	dst[n] = 0;
+}
+
+/* Format the next line for a subscriber, returns 0 if none pending */
+static int sub_format(struct sub *sub)
+{
+	struct event *ev = NULL;
+	char ifname[6 * sizeof(ev->ifname) + 1];
+	uint64_t lost;
+	int len;
+
+	while (!ev && sub->sync < sub->nsync) {
+		ev = &iftab[sub->sync++];
+		if (ev->type != EV_IFADD)
+			ev = NULL;
+	}
+
+	if (!ev && sub->tail == head)
+		return 0;
+
+	if (!ev && head - sub->tail > EVENTS_RING) {
+		lost = head - sub->tail - EVENTS_RING;
+		sub->dropped += lost;
+		sub->tail    += lost;
+
+		len = snprintf(sub->buf, sizeof(sub->buf),
+			       "{\"event\":\"dropped\",\"count\":%llu,\"total\":%llu}\n",
+			       (unsigned long long)lost, (unsigned long long)sub->dropped);
+	} else {
+		if (!ev)
+			ev = &ring[sub->tail++ & (EVENTS_RING - 1)];
+		json_escape(ifname, sizeof(ifname), ev->ifname);
+		len = snprintf(sub->buf, sizeof(sub->buf),
+			       "{\"time\":%lld.%03ld,\"event\":\"%s\",\"iface\":\"%s\","
+			       "\"family\":\"%s\",\"interval\":%u,\"result\":\"%s\"}\n",
+			       (long long)ev->ts.tv_sec, ev->ts.tv_nsec / 1000000,
+			       evname[ev->type], ifname,
+			       ev->af == AF_INET ? "inet" : "inet6", ev->interval,
+			       ev->failed ? "failed" : "ok");
+	}
+
+	if (len >= (int)sizeof(sub->buf))
+		len = sizeof(sub->buf) - 1;
+	sub->len = len;
+	sub->off = 0;
+
+	return 1;
+}
+
+static void sub_flush(struct sub *sub)
+{
+	ssize_t num;
+
+	while (sub->off < sub->len || sub_format(sub)) {
+		num = send(sub->sd, sub->buf + sub->off, sub->len - sub->off,
+			   MSG_DONTWAIT | MSG_NOSIGNAL);
+		if (num < 0) {
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+				sub_close(sub);
+			return;
+		}
+
+		sub->off += num;
+	}
+}
+
+void events_exit(void)
+{
+	int i;
+
+	/* Best effort, let subscribers see the final terminate events */
+	for (i = 0; i < EVENTS_SUBS; i++) {
+		if (subs[i].sd < 0)
+			continue;
+
+		sub_flush(&subs[i]);
+		if (subs[i].sd >= 0)
+			sub_close(&subs[i]);
+	}
+
+	free(iftab);
+	iftab = NULL;
+	iflen = ifmax = 0;
+
+	if (lsd < 0)
+		return;
+
+	close(lsd);
+	unlink(sock_path);
+}
+
+static void sub_accept(void)
+{
+	int i, sd;
+
+	sd = accept4(lsd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+	if (sd < 0)
+		return;
+
+	for (i = 0; i < EVENTS_SUBS; i++) {
+		if (subs[i].sd >= 0)
+			continue;
+
+		memset(&subs[i], 0, sizeof(subs[i]));
+		subs[i].sd    = sd;
+		subs[i].nsync = iflen;
+		subs[i].tail  = head;
+		nsubs++;
+		return;
+	}
+
+	close(sd);
+}
+
+/*
+ * Set up poll descriptors for the listening socket and all subscribers,
+ * the latter only ask for POLLOUT when they have events pending.
+ */
+int events_poll_init(struct pollfd pfd[])
+{
+	int i, n = 0;
+
+	if (lsd < 0)
+		return 0;
+
+	pfd[n].fd = lsd;
+	pfd[n++].events = POLLIN;
+
+	for (i = 0; i < EVENTS_SUBS; i++) {
+		struct sub *sub = &subs[i];
+
+		pfd[n].fd = sub->sd;
+		pfd[n].events = POLLIN;
+		if (sub->off < sub->len || sub_pending(sub))
+			pfd[n].events |= POLLOUT;
+		n++;
+	}
+
+	return n;
+}
+
+void events_poll(const struct pollfd pfd[], int npfd)
+{
+	char buf[64];
+	int i;
+
+	if (npfd < 1)
+		return;
+
+	if (pfd[0].revents & POLLIN)
+		sub_accept();
+
+	for (i = 1; i < npfd; i++) {
+		struct sub *sub = &subs[i - 1];
+
+		if (sub->sd < 0 || pfd[i].fd != sub->sd)
+			continue;
+
+		/* Subscribers are not expected to talk, only hang up */
+		if (pfd[i].revents & (POLLHUP | POLLERR) ||
+		    (pfd[i].revents & POLLIN && recv(sub->sd, buf, sizeof(buf), MSG_DONTWAIT) <= 0)) {
+			sub_close(sub);
+			continue;
+		}
+
+		if (pfd[i].revents & POLLOUT)
+			sub_flush(sub);
+	}
+}
+
+/**
+ * Local Variables:
+ *  indent-tabs-mode: t
+ *  c-file-style: "linux"
+ * End:
+ */
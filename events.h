@@ -0,0 +1,31 @@
+#define EVENTS_PATH          "/run/mrdisc.sock"
+#define EVENTS_RING          256	/* Power of two */
+#define EVENTS_SUBS          8
+
+enum {
+	EV_IFADD,
+	EV_IFDEL,
+	EV_ANNOUNCE,
+	EV_SOLICIT,
+	EV_TERMINATE,
+};
+
+struct pollfd;
+
+#ifdef ENABLE_EVENTS
+#define EVENTS_NFDS          (1 + EVENTS_SUBS)
+
+int  events_init      (const char *path);
+void events_exit      (void);
+void events_push      (int type, int af, char *ifname, uint8_t interval, int failed);
+int  events_poll_init (struct pollfd *pfd);
+void events_poll      (const struct pollfd *pfd, int npfd);
+#else
+#define EVENTS_NFDS          0
+
+static inline int  events_init      (const char *path) { return 0; }
+static inline void events_exit      (void) { }
+static inline void events_push      (int type, int af, char *ifname, uint8_t interval, int failed) { }
+static inline int  events_poll_init (struct pollfd *pfd) { return 0; }
+static inline void events_poll      (const struct pollfd *pfd, int npfd) { }
+#endif
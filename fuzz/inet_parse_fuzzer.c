@@ -0,0 +1,134 @@
+/* Fuzz target for the IPv4 receive parser, inet_parse()
+ *
+ * Copyright (c) 2017-2021  Joachim Wiberg <troglobit@gmail.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <netinet/ip.h>
+#include <netinet/igmp.h>
+
+#include "inet.h"
+
+/*
+ * libFuzzer entry point.  The input is copied to a buffer of exactly
+ * the input size, so ASan flags any read past the bytes "received".
+ */
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	char *buf;
+
+	buf = malloc(size ? size : 1);
+	if (!buf)
+		return 0;
+
+	memcpy(buf, data, size);
+	inet_parse(buf, size);
+	free(buf);
+
+	return 0;
+}
+
+#ifndef LIBFUZZER
+#define ROUNDS  200000
+
+uint16_t in_cksum(const void *buf, size_t len);
+
+/* Valid solicitation: IP header with Router Alert, then IGMP */
+static size_t seed(uint8_t *pkt)
+{
+	struct ip *ip = (struct ip *)pkt;
+	struct igmp *igmp = (struct igmp *)(pkt + 24);
+
+	memset(pkt, 0, 32);
+	ip->ip_v  = 4;
+	ip->ip_hl = 6;
+	ip->ip_p  = IPPROTO_IGMP;
+	pkt[20]   = IPOPT_RA;
+	pkt[21]   = 4;
+	igmp->igmp_type  = IGMP_MRDISC_SOLICIT;
+	igmp->igmp_cksum = in_cksum(igmp, 8);
+
+	return 32;
+}
+
+static int run_file(const char *fn)
+{
+	static uint8_t data[65536];
+	size_t len;
+	FILE *fp;
+
+	fp = fopen(fn, "r");
+	if (!fp) {
+		perror(fn);
+		return 1;
+	}
+
+	len = fread(data, 1, sizeof(data), fp);
+	fclose(fp);
+
+	return LLVMFuzzerTestOneInput(data, len);
+}
+
+/*
+ * Without libFuzzer, run any files given as arguments, e.g. a corpus
+ * or crash reproducers.  Otherwise mutate a valid solicitation: flip
+ * bytes, and truncate or extend it at random.
+ */
+int main(int argc, char *argv[])
+{
+	uint8_t base[32], pkt[64];
+	size_t len, blen;
+	int i, j, rc = 0;
+
+	if (argc > 1) {
+		for (i = 1; i < argc; i++)
+			rc |= run_file(argv[i]);
+		return rc;
+	}
+
+	blen = seed(base);
+	if (inet_parse((char *)base, blen) != IGMP_MRDISC_SOLICIT) {
+		printf("FAIL: valid solicitation rejected\n");
+		return 1;
+	}
+
+	srand(4286);
+	for (i = 0; i < ROUNDS; i++) {
+		memcpy(pkt, base, blen);
+		for (j = rand() % 4; j >= 0; j--)
+			pkt[rand() % blen] = rand();
+
+		len = rand() % sizeof(pkt);
+		if (len > blen)
+			memset(pkt + blen, rand(), len - blen);
+
+		LLVMFuzzerTestOneInput(pkt, len);
+	}
+	printf("PASS: %d inputs\n", ROUNDS);
+
+	return 0;
+}
+#endif /* LIBFUZZER */
+
+/**
+ * Local Variables:
+ *  indent-tabs-mode: t
+ *  c-file-style: "linux"
+ * End:
+ */
@@ -0,0 +1,358 @@
+/* Replay IGMP/MLD packets from a pcap file through the receive path
+ *
+ * Copyright (c) 2017-2021  Joachim Wiberg <troglobit@gmail.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * The daemon's own inet_recv() and inet6_recv() are used unmodified.
+ * The binary is linked with --wrap=recvmsg,--wrap=sendto so reads
+ * return the next packet from the capture, and replies are captured in
+ * memory instead of sent.  Each packet is kept in a buffer of its exact
+ * size, so with ASan any read past the received bytes is flagged.
+ */
+
+#include <config.h>
+#include <err.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include "inet.h"
+
+#define LINKTYPE_NULL        0
+#define LINKTYPE_ETHERNET    1
+#define LINKTYPE_RAW         101
+#define LINKTYPE_LINUX_SLL   113
+#define LINKTYPE_IPV4        228
+#define LINKTYPE_IPV6        229
+#define LINKTYPE_LINUX_SLL2  276
+
+#define MAX_CAPTURE          1024
+
+struct pkt {
+	int      af;
+	size_t   len;
+	uint8_t *data;
+};
+
+static struct pkt *pkts;
+static size_t      npkts;
+static struct pkt *cur;
+
+/* Replies, last MAX_CAPTURE kept */
+static struct {
+	size_t  len;
+	uint8_t data[64];
+} capture[MAX_CAPTURE];
+static size_t nsent;
+
+ssize_t __wrap_recvmsg(int sd, struct msghdr *msg, int flags)
+{
+	size_t len = cur->len;
+
+	if (len > msg->msg_iov[0].iov_len)
+		len = msg->msg_iov[0].iov_len;
+	memcpy(msg->msg_iov[0].iov_base, cur->data, len);
+	msg->msg_controllen = 0;
+
+	return len;
+}
+
+ssize_t __wrap_sendto(int sd, const void *buf, size_t len, int flags,
+		      const struct sockaddr *dest, socklen_t addrlen)
+{
+	size_t i = nsent++ % MAX_CAPTURE;
+
+	capture[i].len = len < sizeof(capture[i].data) ? len : sizeof(capture[i].data);
+	memcpy(capture[i].data, buf, capture[i].len);
+
+	return len;
+}
+
+static uint16_t get16(const uint8_t *p)
+{
+	return (p[0] << 8) | p[1];
+}
+
+static uint32_t get32(const uint8_t *p, int swap)
+{
+	uint32_t v;
+
+	memcpy(&v, p, sizeof(v));
+	if (swap)
+		v = __builtin_bswap32(v);
+
+	return v;
+}
+
+static void add(int af, const uint8_t *data, size_t len)
+{
+	struct pkt *pkt;
+
+	pkts = realloc(pkts, (npkts + 1) * sizeof(*pkts));
+	if (!pkts)
+		err(1, "Failed allocating packet list");
+
+	pkt = &pkts[npkts++];
+	pkt->af   = af;
+	pkt->len  = len;
+	pkt->data = malloc(len ? len : 1);
+	if (!pkt->data)
+		err(1, "Failed allocating packet");
+	memcpy(pkt->data, data, len);
+}
+
+/*
+ * Keep IPv4 IGMP as the full IP datagram, and ICMPv6 without the IPv6
+ * header and extension headers, i.e., what a raw socket would read.
+ * The kernel trims link layer padding, e.g. Ethernet frames shorter
+ * than 60 bytes, to the IP length before delivery, so we do too.
+ */
+static void classify(const uint8_t *p, size_t len)
+{
+	size_t off, iplen;
+	uint8_t nh;
+
+	if (len < 1)
+		return;
+
+	switch (p[0] >> 4) {
+	case 4:
+		if (len < 20)
+			return;
+
+		iplen = (p[2] << 8) | p[3];
+		if (iplen < (size_t)(p[0] & 0x0f) * 4 || iplen < 20 || iplen > len)
+			return;
+
+		if (p[9] == IPPROTO_IGMP)
+			add(AF_INET, p, iplen);
+		break;
+
+	case 6:
+		if (len < 40)
+			return;
+
+		iplen = 40 + ((p[4] << 8) | p[5]);
+		if (iplen > len)
+			return;
+		len = iplen;
+
+		nh  = p[6];
+		off = 40;
+		while (nh == IPPROTO_HOPOPTS || nh == IPPROTO_DSTOPTS || nh == IPPROTO_ROUTING) {
+			if (off + 2 > len)
+				return;
+			nh   = p[off];
+			off += (p[off + 1] + 1) * 8;
+		}
+
+		if (nh == IPPROTO_ICMPV6 && off <= len)
+			add(AF_INET6, p + off, len - off);
+		break;
+	}
+}
+
+/* Strip the link layer header, return offset to IP header or -1 */
+static long linkhdr(uint32_t linktype, const uint8_t *p, size_t len)
+{
+	uint16_t proto;
+	size_t off;
+
+	switch (linktype) {
+	case LINKTYPE_RAW:
+	case LINKTYPE_IPV4:
+	case LINKTYPE_IPV6:
+		return 0;
+
+	case LINKTYPE_NULL:
+		return 4;
+
+	case LINKTYPE_ETHERNET:
+		off = 12;
+		do {
+			if (off + 2 > len)
+				return -1;
+			proto = get16(p + off);
+			off  += (proto == 0x8100 || proto == 0x88a8) ? 4 : 2;
+		} while (proto == 0x8100 || proto == 0x88a8);
+		break;
+
+	case LINKTYPE_LINUX_SLL:
+		if (len < 16)
+			return -1;
+		proto = get16(p + 14);
+		off   = 16;
+		break;
+
+	case LINKTYPE_LINUX_SLL2:
+		if (len < 20)
+			return -1;
+		proto = get16(p);
+		off   = 20;
+		break;
+
+	default:
+		errx(1, "Unsupported pcap link type %u", linktype);
+	}
+
+	if (proto != 0x0800 && proto != 0x86dd)
+		return -1;
+
+	return off;
+}
+
+static void load(const char *fn)
+{
+	uint8_t hdr[24], rec[16], *buf;
+	uint32_t magic, linktype, caplen;
+	int swap;
+	long off;
+	FILE *fp;
+
+	fp = fopen(fn, "r");
+	if (!fp)
+		err(1, "Cannot open %s", fn);
+
+	if (fread(hdr, sizeof(hdr), 1, fp) != 1)
+		errx(1, "%s: too short for a pcap file", fn);
+
+	magic = get32(hdr, 0);
+	if (magic == 0xa1b2c3d4 || magic == 0xa1b23c4d)
+		swap = 0;
+	else if (magic == 0xd4c3b2a1 || magic == 0x4d3cb2a1)
+		swap = 1;
+	else
+		errx(1, "%s: not a pcap file, pcapng is not supported", fn);
+
+	linktype = get32(hdr + 20, swap) & 0xffff;
+
+	buf = malloc(262144);
+	if (!buf)
+		err(1, "Failed allocating buffer");
+
+	while (fread(rec, sizeof(rec), 1, fp) == 1) {
+		caplen = get32(rec + 8, swap);
+		if (caplen > 262144)
+			errx(1, "%s: corrupt record, caplen %u", fn, caplen);
+		if (fread(buf, caplen, 1, fp) != 1)
+			break;
+
+		off = linkhdr(linktype, buf, caplen);
+		if (off >= 0 && (size_t)off <= caplen)
+			classify(buf + off, caplen - off);
+	}
+
+	free(buf);
+	fclose(fp);
+}
+
+static int usage(int code)
+{
+	printf("Usage: pcap_replay [-n ROUNDS] [-v] FILE.pcap\n"
+	       "\n"
+	       "    -n ROUNDS  Replay the capture ROUNDS times, default 1000\n"
+	       "    -v         Show captured replies from the first round\n");
+
+	return code;
+}
+
+int main(int argc, char *argv[])
+{
+	size_t i, igmp = 0, mld = 0, replies = 0;
+	uint32_t drops = 0;
+	long rounds = 1000, r;
+	struct timespec start, end;
+	double sec;
+	int c, verbose = 0;
+
+	while ((c = getopt(argc, argv, "hn:v")) != EOF) {
+		switch (c) {
+		case 'n':
+			rounds = atol(optarg);
+			if (rounds < 1)
+				errx(1, "Invalid number of rounds");
+			break;
+		case 'v':
+			verbose = 1;
+			break;
+		case 'h':
+			return usage(0);
+		default:
+			return usage(1);
+		}
+	}
+
+	if (optind >= argc)
+		return usage(1);
+
+	load(argv[optind]);
+	if (!npkts)
+		errx(1, "No IGMP or ICMPv6 packets in %s", argv[optind]);
+
+	for (i = 0; i < npkts; i++) {
+		if (pkts[i].af == AF_INET)
+			igmp++;
+		else
+			mld++;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (r = 0; r < rounds; r++) {
+		for (i = 0; i < npkts; i++) {
+			cur = &pkts[i];
+#ifdef ENABLE_IPV4
+			if (cur->af == AF_INET)
+				inet_recv(-1, 20, &drops);
+#endif
+#ifdef ENABLE_IPV6
+			if (cur->af == AF_INET6)
+				inet6_recv(-1, 20, &drops);
+#endif
+		}
+
+		if (!r) {
+			replies = nsent;
+			for (i = 0; verbose && i < replies && i < MAX_CAPTURE; i++)
+				printf("reply %zu: type 0x%02x code %u, %zu bytes\n", i,
+				       capture[i].data[0], capture[i].data[1], capture[i].len);
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	sec = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+	printf("%zu packets (%zu IGMP, %zu ICMPv6), %zu solicitations answered per round\n",
+	       npkts, igmp, mld, replies);
+	printf("%ld rounds in %.3f ms, %.0f pkts/s\n", rounds, sec * 1000.0,
+	       sec > 0 ? (double)npkts * rounds / sec : 0.0);
+
+	for (i = 0; i < npkts; i++)
+		free(pkts[i].data);
+	free(pkts);
+
+	return 0;
+}
+
+/**
+ * Local Variables:
+ *  indent-tabs-mode: t
+ *  c-file-style: "linux"
+ * End:
+ */
@@ -15,149 +15,279 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <config.h>
 #include <err.h>
 #include <errno.h>
 #include <poll.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <sys/socket.h>
-#include <time.h>
 
+#include "events.h"
+#include "stats.h"
 #include "if.h"
 #include "inet.h"
 
-size_t   ifnum4 = 0;
-size_t   ifnum6 = 0;
-ifsock_t iflist4[MAX_NUM_IFACES];
-ifsock_t iflist6[MAX_NUM_IFACES];
-
-void if_init4(char *iface[], int num)
+#ifdef ENABLE_SOLICIT
+#define IF_RECV(fn)  .recv = fn
+#else
+#define IF_RECV(fn)  .recv = NULL
+#endif
+
+static const struct ifops ifops[IF_NUM_AF] = {
+#ifdef ENABLE_IPV4
+	[IF_INET] = {
+		.af       = AF_INET,
+		.proto    = "IGMP",
+		.announce = IGMP_MRDISC_ANNOUNCE,
+		.open     = inet_open,
+		.close    = inet_close,
+		.send     = inet_send,
+		IF_RECV(inet_recv),
+	},
+#endif
+#ifdef ENABLE_IPV6
+	[IF_INET6] = {
+		.af       = AF_INET6,
+		.proto    = "ICMPv6",
+		.announce = ICMP6_MRDISC_ANNOUNCE,
+		.open     = inet6_open,
+		.close    = inet6_close,
+		.send     = inet6_send,
+		IF_RECV(inet6_recv),
+	},
+#endif
+};
+
+struct iface  *iflist;
+size_t         ifnum = 0;
+int            rcvbuf_max = RCVBUF_MAX;
+
+/* Poll descriptors, and the socket each of them belongs to */
+static struct pollfd *pfd;
+static ifsock_t     **pfs;
+static size_t         nsock;
+
+uint64_t now_ms(void);
+
+/*
+ * Open a socket per address family on each interface, or only for af,
+ * unless it is AF_UNSPEC.  Interfaces without any usable socket are
+ * skipped.  Everything is sized from num, embedded systems have little
+ * RAM.
+ */
+void if_init(char *iface[], int num, int af)
 {
-	int i, sd;
-	char *ifname;
+	size_t npfd;
+	int i, j;
 
-	for (i = 0; i < num; i++) {
-		ifname = iface[i];
+	iflist = calloc(num, sizeof(struct iface));
+	if (!iflist)
+		err(1, "Failed allocating interface list");
 
-		sd = inet_open(ifname);
-		if (sd < 0)
-			continue;
+	for (i = 0; i < num; i++) {
+		struct iface *ifp = &iflist[ifnum];
+		int active = 0;
+
+		ifp->ifname = iface[i];
+		for (j = 0; j < IF_NUM_AF; j++) {
+			const struct ifops *ops = &ifops[j];
+			ifsock_t *s = &ifp->sock[j];
+
+			s->sd = -1;
+			if (af != AF_UNSPEC && af != ops->af)
+				continue;
+
+			s->sd = ops->open(ifp->ifname);
+			if (s->sd < 0)
+				continue;
+
+			s->ifname = ifp->ifname;
+			s->ops    = ops;
+			s->st     = stats_iface(ifp->ifname, ops->af);
+			events_push(EV_IFADD, ops->af, ifp->ifname, 0, 0);
+			active++;
+		}
 
-		iflist4[ifnum4].sd = sd;
-		iflist4[ifnum4].ifname = ifname;
+		if (active) {
+			nsock += active;
+			ifnum++;
+		}
+	}
 
-		ifnum4++;
+#ifndef ENABLE_SOLICIT
+	/* Interface sockets are never read, only poll event subscribers */
+	nsock = 0;
+#endif
+	npfd = nsock + EVENTS_NFDS;
+	if (!npfd)
+		return;
+
+	pfd = calloc(npfd, sizeof(struct pollfd));
+	pfs = calloc(npfd, sizeof(ifsock_t *));
+	if (!pfd || !pfs)
+		err(1, "Failed allocating poll descriptors");
+
+	for (i = 0, npfd = 0; npfd < nsock; i++) {
+		for (j = 0; j < IF_NUM_AF; j++) {
+			ifsock_t *s = &iflist[i].sock[j];
+
+			if (s->sd < 0)
+				continue;
+
+			pfd[npfd].fd     = s->sd;
+			pfd[npfd].events = POLLIN | POLLPRI | POLLHUP;
+			pfs[npfd++]      = s;
+		}
 	}
 }
 
-void if_init6(char *iface[], int num)
+int if_exit(void)
 {
-	int i, sd;
-	char *ifname;
-
-	for (i = 0; i < num; i++) {
-		ifname = iface[i];
+	size_t i;
+	int ret = 0, rc, j;
 
-		sd = inet6_open(ifname);
-		if (sd < 0)
-			continue;
+	for (i = 0; i < ifnum; i++) {
+		for (j = 0; j < IF_NUM_AF; j++) {
+			ifsock_t *s = &iflist[i].sock[j];
 
-		iflist6[ifnum6].sd = sd;
-		iflist6[ifnum6].ifname = ifname;
+			if (s->sd < 0)
+				continue;
 
-		ifnum6++;
+			rc = s->ops->close(s->sd);
+			events_push(EV_TERMINATE, s->ops->af, s->ifname, 0, rc);
+			events_push(EV_IFDEL, s->ops->af, s->ifname, 0, 0);
+			ret |= rc;
+		}
 	}
-}
 
-int if_exit(void)
-{
-	size_t i;
-	int ret = 0;
-
-	for (i = 0; i < ifnum4; i++)
-		ret |= inet_close(iflist4[i].sd);
-	for (i = 0; i < ifnum6; i++)
-		ret |= inet6_close(iflist6[i].sd);
+	free(iflist);
+	free(pfd);
+	free(pfs);
 
 	return ret;
 }
 
-void if_send4(uint8_t interval)
+void if_send(uint8_t interval)
 {
 	size_t i;
-
-	for (i = 0; i < ifnum4; i++) {
-		if (inet_send(iflist4[i].sd, IGMP_MRDISC_ANNOUNCE, interval))
-			warn("Failed sending IGMP control message 0x%x on %s",
-			     IGMP_MRDISC_ANNOUNCE, iflist4[i].ifname);
+	int j, rc;
+
+	for (i = 0; i < ifnum; i++) {
+		for (j = 0; j < IF_NUM_AF; j++) {
+			ifsock_t *s = &iflist[i].sock[j];
+			const struct ifops *ops = s->ops;
+
+			if (s->sd < 0)
+				continue;
+
+			rc = ops->send(s->sd, ops->announce, interval);
+			if (rc) {
+				warn("Failed sending %s control message 0x%x on %s",
+				     ops->proto, ops->announce, s->ifname);
+				stats_inc(s->st, failures);
+			} else
+				stats_inc(s->st, sent);
+			events_push(EV_ANNOUNCE, ops->af, s->ifname, interval, rc);
+		}
 	}
 }
 
-void if_send6(uint8_t interval)
+#ifdef ENABLE_SOLICIT
+/*
+ * Called when the kernel reports it has dropped frames on a socket.
+ * Log it and double the socket receive buffer, up to rcvbuf_max, so
+ * the buffer size follows the load.
+ */
+static void if_drops(ifsock_t *s, uint32_t drops)
 {
-	size_t i;
+	socklen_t len;
+	int size;
 
-	for (i = 0; i < ifnum6; i++) {
-		if (inet6_send(iflist6[i].sd, ICMP6_MRDISC_ANNOUNCE, interval))
-			warn("Failed sending ICMPv6 control message 0x%x on %s",
-			     ICMP6_MRDISC_ANNOUNCE, iflist6[i].ifname);
-	}
-}
+	warnx("%s: receive queue overflow, %u frames dropped (%u total)",
+	      s->ifname, drops - s->drops, drops);
+	s->drops = drops;
+	stats_set(s->st, drops, drops);
 
-static void if_poll_init(const ifsock_t sd_arr[], struct pollfd pfd[], int npfd)
-{
-	int i;
+	len = sizeof(size);
+	if (getsockopt(s->sd, SOL_SOCKET, SO_RCVBUF, &size, &len))
+		return;
 
-	for (i = 0; i < npfd; i++) {
-		pfd[i].fd = sd_arr[i].sd;
-		pfd[i].events = POLLIN | POLLPRI | POLLHUP;
-	}
+	/* Linux reports twice the value set, for bookkeeping overhead */
+	size /= 2;
+	if (size >= rcvbuf_max)
+		return;
+
+	size *= 2;
+	if (size > rcvbuf_max)
+		size = rcvbuf_max;
+
+	if (setsockopt(s->sd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size)))
+		warn("%s: failed growing receive buffer to %d bytes", s->ifname, size);
 }
 
-static int if_recv(int sd, int af, uint8_t interval)
+static void if_solicit(ifsock_t *s, int rc, uint8_t interval)
 {
-	switch (af) {
-	case AF_INET:
-		return inet_recv(sd, interval);
-	case AF_INET6:
-		return inet6_recv(sd, interval);
-	default:
-		return -1;
-	}
+	stats_inc(s->st, received);
+	if (rc == RECV_IGNORED)
+		return;
+
+	stats_inc(s->st, solicits);
+	if (rc == RECV_FAILED) {
+		warn("Failed answering %s solicitation on %s", s->ops->proto, s->ifname);
+		stats_inc(s->st, failures);
+	} else
+		stats_inc(s->st, sent);
+	events_push(EV_SOLICIT, s->ops->af, s->ifname, interval, rc == RECV_FAILED);
 }
 
-static int if_poll_recv(int af, const ifsock_t sd_arr[],
-			const struct pollfd pfd[],
-			int npfd, int npoll, uint8_t interval)
+static int if_poll_recv(int npoll, uint8_t interval)
 {
-	int i;
+	uint32_t drops;
+	size_t i;
+	int rc;
 
-	for (i = 0; npoll > 0 && i < npfd; i++) {
-		int   sd     = sd_arr[i].sd;
-		char *ifname = sd_arr[i].ifname;
+	for (i = 0; npoll > 0 && i < nsock; i++) {
+		ifsock_t *s = pfs[i];
 
-		if (pfd[i].revents & POLLIN) {
-			if (if_recv(sd, af, interval))
-				warn("Failed reading from interface %s", ifname);
-			npoll--;
-		}
+		if (!(pfd[i].revents & POLLIN))
+			continue;
+
+		drops = s->drops;
+		rc = s->ops->recv(s->sd, interval, &drops);
+		if (rc < 0)
+			warn("Failed reading from interface %s", s->ifname);
+		else
+			if_solicit(s, rc, interval);
+
+		if (drops != s->drops)
+			if_drops(s, drops);
+		npoll--;
 	}
 
 	return npoll;
 }
+#endif /* ENABLE_SOLICIT */
 
-void if_poll(uint8_t interval)
+/*
+ * Wait until end, the next announcement deadline.  One poll() covers
+ * all interface sockets, both address families, and event subscribers.
+ */
+void if_poll(uint64_t end, uint8_t interval)
 {
-	size_t i;
-	int num;
-	time_t end = time(NULL) + interval;
-	struct pollfd pfd[MAX_NUM_IFACES*2];
-
-	if_poll_init(iflist4, &pfd[0], ifnum4);
-	if_poll_init(iflist6, &pfd[ifnum4], ifnum6);
+	uint64_t now;
+	int num, nev;
 
 	while (1) {
-		num = poll(pfd, ifnum4 + ifnum6, (end - time(NULL)) * 1000);
+		now = now_ms();
+		if (now >= end)
+			break;
+
+		/* Event subscribers come and go, and only want POLLOUT when needed */
+		nev = events_poll_init(&pfd[nsock]);
+
+		num = poll(pfd, nsock + nev, end - now);
 		if (num < 0) {
 			if (EINTR == errno)
 				break;
@@ -168,8 +298,10 @@ void if_poll(uint8_t interval)
 		if (num == 0)
 			break;
 
-		num = if_poll_recv(AF_INET, iflist4, &pfd[0], ifnum4, num, interval);
-		num = if_poll_recv(AF_INET6, iflist6, &pfd[ifnum4], ifnum6, num, interval);
+#ifdef ENABLE_SOLICIT
+		num = if_poll_recv(num, interval);
+#endif
+		events_poll(&pfd[nsock], nev);
 	}
 }
 
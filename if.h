@@ -1,14 +1,48 @@
-#define MAX_NUM_IFACES       100
+#define RCVBUF_MAX           (256 * 1024)
 
+/* Index in the per-family ops table and in each interface record */
+enum {
+#ifdef ENABLE_IPV4
+	IF_INET,
+#endif
+#ifdef ENABLE_IPV6
+	IF_INET6,
+#endif
+	IF_NUM_AF
+};
+
+struct ifstats;
+
+/* Per address family operations, see ifops[] in if.c */
+struct ifops {
+	int         af;
+	const char *proto;	/* For log messages */
+	uint8_t     announce;	/* Announcement message type */
+
+	int       (*open)  (char *ifname);
+	int       (*close) (int sd);
+	int       (*send)  (int sd, uint8_t type, uint8_t interval);
+	int       (*recv)  (int sd, uint8_t interval, uint32_t *drops);
+};
+
+/* One address family endpoint on an interface, sd < 0 when unused */
 typedef struct {
-	int   sd;
-	char *ifname;
+	int                 sd;
+	char               *ifname;
+	const struct ifops *ops;
+	uint32_t            drops;	/* Last seen kernel drop counter */
+	struct ifstats     *st;
 } ifsock_t;
 
-void if_init4 (char *iface[], int num);
-void if_init6 (char *iface[], int num);
+struct iface {
+	char     *ifname;
+	ifsock_t  sock[IF_NUM_AF];
+};
+
+extern int rcvbuf_max;
+
+void if_init (char *iface[], int num, int af);
 int  if_exit (void);
 
-void if_send4 (uint8_t interval);
-void if_send6 (uint8_t interval);
-void if_poll (uint8_t interval);
+void if_send (uint8_t interval);
+void if_poll (uint64_t end, uint8_t interval);
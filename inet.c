@@ -15,6 +15,7 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <config.h>
 #include <err.h>
 #include <errno.h>
 #include <stdio.h>
@@ -24,27 +25,32 @@
 #include <arpa/inet.h>
 #include <net/if.h>
 #include <netinet/ip.h>
-#include <netinet/ip6.h>
 #include <netinet/igmp.h>
-#include <netinet/icmp6.h>
 #include <sys/socket.h>
+#include <linux/filter.h>
 
 #include "inet.h"
 
 #define MC_ALL_ROUTERS       "224.0.0.2"
-#define MC6_ALL_ROUTERS      "ff02::2"
 #define MC_ALL_SNOOPERS      "224.0.0.106"
-#define MC6_ALL_SNOOPERS     "ff02::6a"
 
-uint16_t in_cksum(uint16_t *p, size_t len);
-void compose_addr6(struct sockaddr_in6 *sin, char *group);
+uint16_t in_cksum(const void *buf, size_t len);
+uint16_t in_cksum_update(uint16_t cksum, uint16_t old, uint16_t new);
+ssize_t recv_ovfl(int sd, char *buf, size_t len, uint32_t *drops);
+
+#ifndef ENABLE_SOLICIT
+static struct sock_filter drop_insn = BPF_STMT(BPF_RET | BPF_K, 0);
+static struct sock_fprog  drop_all  = { 1, &drop_insn };
+#endif
 
 int inet_open(char *ifname)
 {
 	char loop;
 	int sd, val, rc;
 	struct ifreq ifr;
+#ifdef ENABLE_SOLICIT
 	struct ip_mreqn mreq;
+#endif
 	unsigned char ra[4] = { IPOPT_RA, 0x04, 0x00, 0x00 };
 
 	sd = socket(AF_INET, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_IGMP);
@@ -63,11 +69,18 @@ int inet_open(char *ifname)
 		err(1, "Cannot bind socket to interface %s", ifname);
 	}
 
+#ifdef ENABLE_SOLICIT
 	memset(&mreq, 0, sizeof(mreq));
 	mreq.imr_multiaddr.s_addr = inet_addr(MC_ALL_ROUTERS);
 	mreq.imr_ifindex = if_nametoindex(ifname);
         if (setsockopt(sd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)))
 		err(1, "Failed joining group %s", MC_ALL_ROUTERS);
+#else
+	/* Never read, so have the kernel drop all IGMP before queuing it */
+	rc = setsockopt(sd, SOL_SOCKET, SO_ATTACH_FILTER, &drop_all, sizeof(drop_all));
+	if (rc < 0)
+		warn("Cannot attach receive filter");
+#endif
 
 	val = 1;
 	rc = setsockopt(sd, IPPROTO_IP, IP_MULTICAST_TTL, &val, sizeof(val));
@@ -83,64 +96,12 @@ int inet_open(char *ifname)
 	if (rc < 0)
 		err(1, "Cannot set IP OPTIONS");
 
-	return sd;
-}
-
-int inet6_open(char *ifname)
-{
-	int loop = 0;
-	int sd, hops = 1, rc;
-	struct ifreq ifr;
-	struct ipv6_mreq mreq;
-
-	/**
-	 * hopopt[8]:
-	 * {
-	 *   "nexthdr": 0x00 (updated by kernel), "hdrextlen": 0x00,
-	 *   "rtalert": {
-	 *     "type": 0x05, "length": 0x00, "value": [ 0x00, 0x00 ] },
-	 *   }
-	 *   "PadN": [ 0x01, 0x00 ]
-	 * }
-	 */
-	unsigned char hopopt[8] = { 0x00, 0x00, 0x05, 0x02, 0x00, 0x00, 0x01, 0x00 };
-
-	sd = socket(AF_INET6, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_ICMPV6);
-	if (sd < 0)
-		err(1, "Cannot open socket");
-
-	memset(&ifr, 0, sizeof(ifr));
-	snprintf(ifr.ifr_name, sizeof(ifr.ifr_name), "%s", ifname);
-	if (setsockopt(sd, SOL_SOCKET, SO_BINDTODEVICE, (void *)&ifr, sizeof(ifr)) < 0) {
-		if (ENODEV == errno) {
-			warnx("Not a valid interface, %s, skipping ...", ifname);
-			close(sd);
-			return -1;
-		}
-
-		err(1, "Cannot bind socket to interface %s", ifname);
-	}
-
-	memset(&mreq, 0, sizeof(mreq));
-	mreq.ipv6mr_interface = if_nametoindex(ifname);
-
-	if(!inet_pton(AF_INET6, MC6_ALL_ROUTERS, &mreq.ipv6mr_multiaddr))
-		err(1, "Failed preparing %s", MC6_ALL_ROUTERS);
-
-	if (setsockopt(sd, IPPROTO_IPV6, IPV6_JOIN_GROUP, (void *) &mreq, sizeof(mreq)))
-		err(1, "Failed joining group %s", MC6_ALL_ROUTERS);
-
-	rc = setsockopt(sd, IPPROTO_IPV6, IPV6_MULTICAST_HOPS, &hops, sizeof(hops));
-	if (rc < 0)
-		err(1, "Cannot set hop limit");
-
-	rc = setsockopt(sd, IPPROTO_IPV6, IPV6_MULTICAST_LOOP, &loop, sizeof(loop));
-	if (rc < 0)
-		err(1, "Cannot disable MC loop");
-
-	rc = setsockopt(sd, IPPROTO_IPV6, IPV6_HOPOPTS, &hopopt, sizeof(hopopt));
+#ifdef ENABLE_SOLICIT
+	val = 1;
+	rc = setsockopt(sd, SOL_SOCKET, SO_RXQ_OVFL, &val, sizeof(val));
 	if (rc < 0)
-		err(1, "Cannot set IPV6 hop-by-hop option");
+		warn("Cannot enable receive queue overflow detection");
+#endif
 
 	return sd;
 }
@@ -151,12 +112,6 @@ int inet_close(int sd)
 		close(sd);
 }
 
-int inet6_close(int sd)
-{
-	return  inet6_send(sd, ICMP6_MRDISC_TERM, 0) ||
-		close(sd);
-}
-
 static void compose_addr(struct sockaddr_in *sin, char *group)
 {
 	memset(sin, 0, sizeof(*sin));
@@ -166,14 +121,25 @@ static void compose_addr(struct sockaddr_in *sin, char *group)
 
 int inet_send(int sd, uint8_t type, uint8_t interval)
 {
+	static struct igmp igmp;
+	uint16_t old, new;
 	ssize_t num;
-	struct igmp igmp;
 	struct sockaddr dest;
 
-	memset(&igmp, 0, sizeof(igmp));
+	/*
+	 * The same packet is sent over and over again, only the type
+	 * and interval change, so patch the checksum instead of doing
+	 * a full recompute.  Zero means not yet calculated.
+	 */
+	memcpy(&old, &igmp, sizeof(old));
 	igmp.igmp_type = type;
 	igmp.igmp_code = interval;
-	igmp.igmp_cksum = in_cksum((uint16_t *)&igmp, sizeof(igmp) / 2);
+	memcpy(&new, &igmp, sizeof(new));
+
+	if (!igmp.igmp_cksum)
+		igmp.igmp_cksum = in_cksum(&igmp, sizeof(igmp));
+	else if (old != new)
+		igmp.igmp_cksum = in_cksum_update(igmp.igmp_cksum, old, new);
 
 	compose_addr((struct sockaddr_in *)&dest, MC_ALL_SNOOPERS);
 
@@ -184,64 +150,79 @@ int inet_send(int sd, uint8_t type, uint8_t interval)
 	return 0;
 }
 
-int inet6_send(int sd, uint8_t type, uint8_t interval)
+#ifdef ENABLE_SOLICIT
+/* Look for the Router Alert option among the IP options, RFC 2113 */
+static int has_ra(const uint8_t *opt, size_t len)
 {
-	ssize_t num;
-	struct icmp6_hdr icmp6;
-	struct sockaddr_in6 dest;
-
-	memset(&icmp6, 0, sizeof(icmp6));
-	icmp6.icmp6_type = type;
-	icmp6.icmp6_code = interval;
-	icmp6.icmp6_cksum = 0; /* updated by kernel */
-
-	compose_addr6(&dest, MC6_ALL_SNOOPERS);
+	size_t i = 0;
+
+	while (i < len) {
+		switch (opt[i]) {
+		case IPOPT_EOL:
+			return 0;
+		case IPOPT_NOP:
+			i++;
+			continue;
+		case IPOPT_RA:
+			return 1;
+		}
 
-	num = sendto(sd, &icmp6, sizeof(icmp6), 0, (struct sockaddr *)&dest,
-		     sizeof(dest));
-	if (num < 0)
-		return 1;
+		if (i + 1 >= len || opt[i + 1] < 2)
+			return 0;
+		i += opt[i + 1];
+	}
 
 	return 0;
 }
 
-int inet_recv(int sd, uint8_t interval)
+/*
+ * Validate a raw IPv4 frame and return the IGMP type, or -1 if it must
+ * be silently ignored.  Nothing read from the wire is trusted: the IP
+ * header length is checked against the number of bytes read, and the
+ * IGMP checksum and Router Alert option are verified.
+ */
+int inet_parse(const char *buf, size_t len)
 {
-	char buf[1530];
-	ssize_t num;
-	struct ip *ip;
-	struct igmp *igmp;
+	const struct ip *ip = (const struct ip *)buf;
+	const struct igmp *igmp;
+	size_t hlen;
 
-	memset(buf, 0, sizeof(buf));
-	num = read(sd, buf, sizeof(buf));
-	if (num < 0)
+	if (len < sizeof(*ip))
 		return -1;
 
-	ip = (struct ip *)buf;
-	igmp = (struct igmp *)(buf + (ip->ip_hl << 2));
-	if (igmp->igmp_type == IGMP_MRDISC_SOLICIT)
-		return inet_send(sd, IGMP_MRDISC_ANNOUNCE, interval);
+	hlen = ip->ip_hl << 2;
+	if (hlen < sizeof(*ip) || len < hlen + IGMP_MRDISC_MINLEN)
+		return -1;
 
-	return 0;
+	if (!has_ra((const uint8_t *)buf + sizeof(*ip), hlen - sizeof(*ip)))
+		return -1;
+
+	if (in_cksum(buf + hlen, len - hlen))
+		return -1;
+
+	igmp = (const struct igmp *)(buf + hlen);
+
+	return igmp->igmp_type;
 }
 
-int inet6_recv(int sd, uint8_t interval)
+int inet_recv(int sd, uint8_t interval, uint32_t *drops)
 {
 	char buf[1530];
 	ssize_t num;
-	struct icmp6_hdr *icmp6;
 
-	memset(buf, 0, sizeof(buf));
-	num = read(sd, buf, sizeof(buf));
-	if (num < (ssize_t)(sizeof(*icmp6)))
+	num = recv_ovfl(sd, buf, sizeof(buf), drops);
+	if (num < 0)
 		return -1;
 
-	icmp6 = (struct icmp6_hdr *)buf;
-	if (icmp6->icmp6_type == ICMP6_MRDISC_SOLICIT)
-		return inet6_send(sd, ICMP6_MRDISC_ANNOUNCE, interval);
+	if (inet_parse(buf, num) != IGMP_MRDISC_SOLICIT)
+		return RECV_IGNORED;
 
-	return 0;
+	if (inet_send(sd, IGMP_MRDISC_ANNOUNCE, interval))
+		return RECV_FAILED;
+
+	return RECV_ANSWERED;
 }
+#endif /* ENABLE_SOLICIT */
 
 /**
  * Local Variables:
@@ -1,10 +1,17 @@
 #define IGMP_MRDISC_ANNOUNCE 0x30
 #define IGMP_MRDISC_SOLICIT  0x31
 #define IGMP_MRDISC_TERM     0x32
+#define IGMP_MRDISC_MINLEN   4		/* type, reserved, checksum */
 
 #define ICMP6_MRDISC_ANNOUNCE	151
 #define ICMP6_MRDISC_SOLICIT	152
 #define ICMP6_MRDISC_TERM	153
+#define ICMP6_MRDISC_MINLEN	4	/* type, reserved, checksum */
+
+/* Outcome of inet_recv() and inet6_recv(), or -1 on read error */
+#define RECV_IGNORED         0	/* Not a solicitation */
+#define RECV_ANSWERED        1
+#define RECV_FAILED          2	/* Solicitation, but reply failed */
 
 int inet_open   (char *ifname);
 int inet6_open  (char *ifname);
@@ -13,6 +20,7 @@ int inet6_close (int sd);
 
 int inet_send  (int sd, uint8_t type, uint8_t interval);
 int inet6_send (int sd, uint8_t type, uint8_t interval);
-int inet_recv  (int sd, uint8_t interval);
-int inet6_recv (int sd, uint8_t interval);
+int inet_parse (const char *buf, size_t len);
+int inet_recv  (int sd, uint8_t interval, uint32_t *drops);
+int inet6_recv (int sd, uint8_t interval, uint32_t *drops);
 
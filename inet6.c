@@ -0,0 +1,171 @@
+/* IPv6 backend
+ *
+ * Copyright (c) 2017-2021  Joachim Wiberg <troglobit@gmail.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <config.h>
+#include <err.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <netinet/ip6.h>
+#include <netinet/icmp6.h>
+#include <sys/socket.h>
+
+#include "inet.h"
+
+#define MC6_ALL_ROUTERS      "ff02::2"
+#define MC6_ALL_SNOOPERS     "ff02::6a"
+
+void compose_addr6(struct sockaddr_in6 *sin, char *group);
+ssize_t recv_ovfl(int sd, char *buf, size_t len, uint32_t *drops);
+
+int inet6_open(char *ifname)
+{
+	int loop = 0;
+	int sd, hops = 1, val, rc;
+	struct ifreq ifr;
+#ifdef ENABLE_SOLICIT
+	struct ipv6_mreq mreq;
+#else
+	struct icmp6_filter filter;
+#endif
+
+	/**
+	 * hopopt[8]:
+	 * {
+	 *   "nexthdr": 0x00 (updated by kernel), "hdrextlen": 0x00,
+	 *   "rtalert": {
+	 *     "type": 0x05, "length": 0x00, "value": [ 0x00, 0x00 ] },
+	 *   }
+	 *   "PadN": [ 0x01, 0x00 ]
+	 * }
+	 */
+	unsigned char hopopt[8] = { 0x00, 0x00, 0x05, 0x02, 0x00, 0x00, 0x01, 0x00 };
+
+	sd = socket(AF_INET6, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_ICMPV6);
+	if (sd < 0)
+		err(1, "Cannot open socket");
+
+	memset(&ifr, 0, sizeof(ifr));
+	snprintf(ifr.ifr_name, sizeof(ifr.ifr_name), "%s", ifname);
+	if (setsockopt(sd, SOL_SOCKET, SO_BINDTODEVICE, (void *)&ifr, sizeof(ifr)) < 0) {
+		if (ENODEV == errno) {
+			warnx("Not a valid interface, %s, skipping ...", ifname);
+			close(sd);
+			return -1;
+		}
+
+		err(1, "Cannot bind socket to interface %s", ifname);
+	}
+
+#ifdef ENABLE_SOLICIT
+	memset(&mreq, 0, sizeof(mreq));
+	mreq.ipv6mr_interface = if_nametoindex(ifname);
+
+	if(!inet_pton(AF_INET6, MC6_ALL_ROUTERS, &mreq.ipv6mr_multiaddr))
+		err(1, "Failed preparing %s", MC6_ALL_ROUTERS);
+
+	if (setsockopt(sd, IPPROTO_IPV6, IPV6_JOIN_GROUP, (void *) &mreq, sizeof(mreq)))
+		err(1, "Failed joining group %s", MC6_ALL_ROUTERS);
+#else
+	/* Never read, so have the kernel drop all ICMPv6 before queuing it */
+	ICMP6_FILTER_SETBLOCKALL(&filter);
+	rc = setsockopt(sd, IPPROTO_ICMPV6, ICMP6_FILTER, &filter, sizeof(filter));
+	if (rc < 0)
+		warn("Cannot set ICMPv6 filter");
+#endif
+
+	rc = setsockopt(sd, IPPROTO_IPV6, IPV6_MULTICAST_HOPS, &hops, sizeof(hops));
+	if (rc < 0)
+		err(1, "Cannot set hop limit");
+
+	rc = setsockopt(sd, IPPROTO_IPV6, IPV6_MULTICAST_LOOP, &loop, sizeof(loop));
+	if (rc < 0)
+		err(1, "Cannot disable MC loop");
+
+	rc = setsockopt(sd, IPPROTO_IPV6, IPV6_HOPOPTS, &hopopt, sizeof(hopopt));
+	if (rc < 0)
+		err(1, "Cannot set IPV6 hop-by-hop option");
+
+#ifdef ENABLE_SOLICIT
+	val = 1;
+	rc = setsockopt(sd, SOL_SOCKET, SO_RXQ_OVFL, &val, sizeof(val));
+	if (rc < 0)
+		warn("Cannot enable receive queue overflow detection");
+#endif
+
+	return sd;
+}
+
+int inet6_close(int sd)
+{
+	return  inet6_send(sd, ICMP6_MRDISC_TERM, 0) ||
+		close(sd);
+}
+
+int inet6_send(int sd, uint8_t type, uint8_t interval)
+{
+	ssize_t num;
+	struct icmp6_hdr icmp6;
+	struct sockaddr_in6 dest;
+
+	memset(&icmp6, 0, sizeof(icmp6));
+	icmp6.icmp6_type = type;
+	icmp6.icmp6_code = interval;
+	icmp6.icmp6_cksum = 0; /* updated by kernel */
+
+	compose_addr6(&dest, MC6_ALL_SNOOPERS);
+
+	num = sendto(sd, &icmp6, sizeof(icmp6), 0, (struct sockaddr *)&dest,
+		     sizeof(dest));
+	if (num < 0)
+		return 1;
+
+	return 0;
+}
+
+#ifdef ENABLE_SOLICIT
+int inet6_recv(int sd, uint8_t interval, uint32_t *drops)
+{
+	char buf[1530];
+	ssize_t num;
+	struct icmp6_hdr *icmp6;
+
+	num = recv_ovfl(sd, buf, sizeof(buf), drops);
+	if (num < 0)
+		return -1;
+
+	icmp6 = (struct icmp6_hdr *)buf;
+	if (num < ICMP6_MRDISC_MINLEN || icmp6->icmp6_type != ICMP6_MRDISC_SOLICIT)
+		return RECV_IGNORED;
+
+	if (inet6_send(sd, ICMP6_MRDISC_ANNOUNCE, interval))
+		return RECV_FAILED;
+
+	return RECV_ANSWERED;
+}
+#endif /* ENABLE_SOLICIT */
+
+/**
+ * Local Variables:
+ *  indent-tabs-mode: t
+ *  c-file-style: "linux"
+ * End:
+ */
@@ -0,0 +1,137 @@
+/* Show mrdisc statistics from the shared memory page
+ *
+ * Copyright (c) 2017-2021  Joachim Wiberg <troglobit@gmail.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <config.h>
+#include <err.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+
+#include "stats.h"
+
+uint64_t now_ms(void);
+
+/*
+ * Reader side of the seqlock, copy len bytes of shm to copy.  Returns
+ * 0 on success, or -1 if the writer kept us out for too long.  Write
+ * sections are a few stores, so a retry is rare; back off anyway, the
+ * writer may have been preempted with seq odd.
+ */
+static int stats_snapshot(const struct stats *shm, struct stats *copy, size_t len)
+{
+	struct timespec ts = { 0, 100000 };
+	uint32_t seq;
+	int retry;
+
+	for (retry = 0; retry < 1000; retry++) {
+		if (retry > 10)
+			nanosleep(&ts, NULL);
+		else if (retry)
+			sched_yield();
+
+		seq = __atomic_load_n(&shm->seq, __ATOMIC_ACQUIRE);
+		if (seq & 1)
+			continue;
+
+		memcpy(copy, shm, len);
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&shm->seq, __ATOMIC_RELAXED) == seq)
+			return 0;
+	}
+
+	return -1;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *path = STATS_PATH;
+	struct stats *shm, *copy;
+	struct stat sb;
+	uint64_t now;
+	uint32_t i;
+	int fd;
+
+	if (argc > 2 || (argc == 2 && argv[1][0] == '-'))
+		errx(1, "Usage: %s [FILE]", argv[0]);
+	if (argc == 2)
+		path = argv[1];
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		err(1, "Cannot open %s, is mrdisc running?", path);
+
+	if (fstat(fd, &sb) || (size_t)sb.st_size < sizeof(*shm))
+		errx(1, "Invalid statistics file %s", path);
+
+	shm = mmap(NULL, sb.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (shm == MAP_FAILED)
+		err(1, "Cannot map %s", path);
+
+	if (__atomic_load_n(&shm->magic, __ATOMIC_ACQUIRE) != STATS_MAGIC ||
+	    shm->version != STATS_VERSION)
+		errx(1, "Unsupported statistics file %s", path);
+
+	copy = malloc(sb.st_size);
+	if (!copy)
+		err(1, "Failed allocating memory");
+
+	if (stats_snapshot(shm, copy, sb.st_size))
+		errx(1, "Timed out waiting for consistent statistics");
+
+	if (copy->ifnum > copy->ifmax ||
+	    sizeof(*copy) + copy->ifmax * sizeof(copy->iface[0]) > (size_t)sb.st_size)
+		errx(1, "Corrupt statistics file %s", path);
+
+	now = now_ms();
+	printf("PID %u, interval %u sec, next announcement in %lld ms, %llu missed deadlines\n\n",
+	       copy->pid, copy->interval,
+	       copy->next > now ? (long long)(copy->next - now) : 0LL,
+	       (unsigned long long)copy->misses);
+
+	printf("%-16s %-6s %10s %10s %10s %10s %10s\n", "INTERFACE", "FAMILY",
+	       "SENT", "RECEIVED", "SOLICITS", "FAILURES", "DROPS");
+	for (i = 0; i < copy->ifnum; i++) {
+		struct ifstats *st = &copy->iface[i];
+
+		printf("%-16.16s %-6s %10llu %10llu %10llu %10llu %10u\n", st->ifname,
+		       st->af == AF_INET ? "IPv4" : "IPv6",
+		       (unsigned long long)st->sent, (unsigned long long)st->received,
+		       (unsigned long long)st->solicits, (unsigned long long)st->failures,
+		       st->drops);
+	}
+
+	free(copy);
+	munmap(shm, sb.st_size);
+
+	return 0;
+}
+
+/**
+ * Local Variables:
+ *  indent-tabs-mode: t
+ *  c-file-style: "linux"
+ * End:
+ */
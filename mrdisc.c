@@ -18,18 +18,34 @@
 #include <config.h>
 #include <err.h>
 #include <getopt.h>
+#include <sched.h>
 #include <stdio.h>
 #include <signal.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
 
+#include "events.h"
+#include "stats.h"
 #include "if.h"
 
 int      running = 1;
 uint8_t  interval = 20;
 char     version_info[] = PACKAGE_NAME " v" PACKAGE_VERSION;
 
+/* Real-time mode, and announcement deadline tracking */
+#define  DEADLINE_SLACK_MS  10
+#define  PREFAULT_STACK     (64 * 1024)
+
+int      rt_cpu  = -1;
+int      rt_prio = 0;
+uint64_t rt_miss = 0;
+uint64_t rt_late = 0;		/* Total, ms */
+uint64_t rt_max  = 0;		/* Worst case, ms */
+
+uint64_t now_ms(void);
 
 static void exit_handler(int signo)
 {
@@ -44,30 +60,142 @@ static void signal_init(void)
 	signal(SIGQUIT, exit_handler);
 }
 
+/* Touch the stack we may need so it is faulted in before mlockall() */
+static void prefault_stack(void)
+{
+	volatile char stack[PREFAULT_STACK];
+	size_t i;
+
+	for (i = 0; i < sizeof(stack); i += 4096)
+		stack[i] = 0;
+}
+
+static void rt_init(void)
+{
+	struct sched_param param;
+	cpu_set_t set;
+
+	if (rt_cpu >= 0) {
+		CPU_ZERO(&set);
+		CPU_SET(rt_cpu, &set);
+		if (sched_setaffinity(0, sizeof(set), &set))
+			err(1, "Failed pinning to CPU %d", rt_cpu);
+	}
+
+	if (!rt_prio)
+		return;
+
+	prefault_stack();
+	if (mlockall(MCL_CURRENT | MCL_FUTURE))
+		err(1, "Failed locking memory");
+
+	memset(&param, 0, sizeof(param));
+	param.sched_priority = rt_prio;
+	if (sched_setscheduler(0, SCHED_FIFO, &param))
+		err(1, "Failed setting SCHED_FIFO priority %d", rt_prio);
+}
+
+/*
+ * Check how late this announcement is compared to its deadline, and
+ * return the next one.  The schedule is absolute, a late announcement
+ * does not push later ones back, so small delays cannot add up.  Only
+ * if more than a whole period was lost do we skip ahead, rather than
+ * sending a burst to catch up.
+ */
+static uint64_t deadline(uint64_t due)
+{
+	uint64_t now = now_ms();
+
+	if (now > due + DEADLINE_SLACK_MS) {
+		uint64_t late = now - due;
+
+		rt_miss++;
+		rt_late += late;
+		if (late > rt_max)
+			rt_max = late;
+	}
+
+	due += interval * 1000;
+	if (due <= now)
+		due = now + interval * 1000;
+
+	stats_deadline(due, rt_miss);
+
+	return due;
+}
+
 static int usage(int code)
 {
-	printf("\nUsage: %s [-4|-6] [-i SEC] IFACE [IFACE ...]\n"
+	printf("\nUsage: %s [-4|-6]"
+#ifdef ENABLE_SOLICIT
+	       " [-b BYTES]"
+#endif
+	       " [-c CPU] [-i SEC] [-p PRIO]"
+#ifdef ENABLE_STATS
+	       " [-s FILE]"
+#endif
+#ifdef ENABLE_EVENTS
+	       " [-u SOCK]"
+#endif
+	       "\n              IFACE [IFACE ...]\n"
 	       "\n"
 	       "    -h        This help text\n"
 	       "    -4        Use IPv4 only\n"
-	       "    -6        Use IPv6 only\n"
+	       "    -6        Use IPv6 only\n", PACKAGE_NAME);
+#ifdef ENABLE_SOLICIT
+	printf("    -b BYTES  Max socket receive buffer, grown on drops, default %d\n", RCVBUF_MAX);
+#endif
+	printf("    -c CPU    Pin daemon to CPU\n"
 	       "    -i SEC    Announce interval, 4-180 sec, default 20 sec\n"
-	       "    -v        Program version\n"
+	       "    -p PRIO   Real-time mode, lock memory and run SCHED_FIFO at PRIO\n");
+#ifdef ENABLE_STATS
+	printf("    -s FILE   Statistics file, default %s\n", STATS_PATH);
+#endif
+#ifdef ENABLE_EVENTS
+	printf("    -u SOCK   Event stream socket, default %s\n", EVENTS_PATH);
+#endif
+	printf("    -v        Program version\n"
 	       "\n"
-	       "Bug report address: %-40s\n\n", PACKAGE_NAME, PACKAGE_BUGREPORT);
+	       "Bug report address: %-40s\n\n", PACKAGE_BUGREPORT);
 
 	return code;
 }
 
 int main(int argc, char *argv[])
 {
+#ifdef ENABLE_IPV4
 	int v4 = 1;
+#else
+	int v4 = 0;
+#endif
+#ifdef ENABLE_IPV6
 	int v6 = 1;
+#else
+	int v6 = 0;
+#endif
+	const char *stats_file = STATS_PATH;
+	const char *events_sock = EVENTS_PATH;
 	int c;
 	int ret;
+	uint64_t due;
 
-	while ((c = getopt(argc, argv, "hi:v46")) != EOF) {
+	while ((c = getopt(argc, argv, "b:c:hi:p:s:u:v46")) != EOF) {
 		switch (c) {
+		case 'b':
+#ifndef ENABLE_SOLICIT
+			errx(1, "Built without solicitation support");
+#endif
+			rcvbuf_max = atoi(optarg);
+			if (rcvbuf_max <= 0)
+				errx(1, "Invalid receive buffer size");
+			break;
+
+		case 'c':
+			rt_cpu = atoi(optarg);
+			if (rt_cpu < 0 || rt_cpu >= CPU_SETSIZE)
+				errx(1, "Invalid CPU %s", optarg);
+			break;
+
 		case 'h':
 			return usage(0);
 
@@ -77,13 +205,40 @@ int main(int argc, char *argv[])
 				errx(1, "Invalid announcement interval [4,180]");
 			break;
 
+		case 'p':
+			rt_prio = atoi(optarg);
+			if (rt_prio < sched_get_priority_min(SCHED_FIFO) ||
+			    rt_prio > sched_get_priority_max(SCHED_FIFO))
+				errx(1, "Invalid SCHED_FIFO priority %s", optarg);
+			break;
+
+		case 's':
+#ifndef ENABLE_STATS
+			errx(1, "Built without statistics support");
+#endif
+			stats_file = optarg;
+			break;
+
+		case 'u':
+#ifndef ENABLE_EVENTS
+			errx(1, "Built without event stream support");
+#endif
+			events_sock = optarg;
+			break;
+
 		case 'v':
 			fprintf(stderr, "%s\n", version_info);
 			return 0;
 		case '4':
+#ifndef ENABLE_IPV4
+			errx(1, "Built without IPv4 support");
+#endif
 			v6 = 0;
 			break;
 		case '6':
+#ifndef ENABLE_IPV6
+			errx(1, "Built without IPv6 support");
+#endif
 			v4 = 0;
 			break;
 
@@ -103,22 +258,33 @@ int main(int argc, char *argv[])
 	}
 
 	signal_init();
+	stats_init(stats_file, (v4 + v6) * (argc - optind), interval);
+	events_init(events_sock);
 
-	if (v4)
-		if_init4(&argv[optind], argc - optind);
-	if (v6)
-		if_init6(&argv[optind], argc - optind);
+	if_init(&argv[optind], argc - optind,
+		v4 && v6 ? AF_UNSPEC : v4 ? AF_INET : AF_INET6);
 
+	rt_init();
+
+	due = now_ms();
 	while (running) {
-		if (v4)
-			if_send4(interval);
-		if (v6)
-			if_send6(interval);
+		due = deadline(due);
+
+		if_send(interval);
 
-		if_poll(interval);
+		if_poll(due, interval);
 	}
 
-	return if_exit();
+	if (rt_miss)
+		warnx("Missed %llu announcement deadlines, avg %llu ms, max %llu ms late",
+		      (unsigned long long)rt_miss, (unsigned long long)(rt_late / rt_miss),
+		      (unsigned long long)rt_max);
+
+	ret = if_exit();
+	events_exit();
+	stats_exit();
+
+	return ret;
 }
 
 /**
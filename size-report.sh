@@ -0,0 +1,53 @@
+#!/bin/sh
+# Report mrdisc footprint: binary size, and when run as root, also RSS
+# and wakeups per hour, measured on $IFACE for $SECS seconds.  Stats
+# file and event socket go in a temp dir, not to disturb a running mrdisc.
+BIN=${1:-./mrdisc}
+IFACE=${IFACE:-lo}
+SECS=${SECS:-60}
+INTERVAL=${INTERVAL:-20}
+
+# Only voluntary switches are wakeups, involuntary ones are preemptions
+ctxsw()
+{
+	awk '/^voluntary_ctxt_switches/ { print $2 }' /proc/$1/status
+}
+
+echo "Binary size"
+echo "==========="
+size "$BIN"
+echo
+
+if [ "$(id -u)" != "0" ]; then
+	echo "Not root, skipping RSS and wakeup measurements."
+	exit 0
+fi
+
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+# Only pass options for features built in, they are rejected otherwise
+OPTS=
+$BIN -h | grep -q -- "-s FILE" && OPTS="$OPTS -s $TMP/mrdisc.stats"
+$BIN -h | grep -q -- "-u SOCK" && OPTS="$OPTS -u $TMP/mrdisc.sock"
+
+$BIN -i $INTERVAL $OPTS $IFACE 2>/dev/null &
+PID=$!
+sleep 1
+if ! kill -0 $PID 2>/dev/null; then
+	echo "Failed starting $BIN on $IFACE"
+	exit 1
+fi
+
+start=$(ctxsw $PID)
+sleep $SECS
+end=$(ctxsw $PID)
+rss=$(awk '/VmRSS/ { print $2 " " $3 }' /proc/$PID/status)
+hwm=$(awk '/VmHWM/ { print $2 " " $3 }' /proc/$PID/status)
+kill $PID
+wait $PID 2>/dev/null
+
+echo "Runtime, $IFACE, interval $INTERVAL sec, $SECS sec sample"
+echo "==========================================================="
+echo "RSS...........: $rss (peak $hwm)"
+echo "Wakeups/hour..: $(( (end - start) * 3600 / SECS ))"
@@ -34,7 +34,7 @@
 #define IGMP_MRDISC_TERM     0x32
 #define ICMP6_MRDISC_SOLICIT 152
 
-uint16_t in_cksum(uint16_t *p, size_t len);
+uint16_t in_cksum(const void *buf, size_t len);
 void compose_addr6(struct sockaddr_in6 *sin, char *group);
 
 static int open_socket(char *ifname)
@@ -134,7 +134,7 @@ static int send_message(int sd, uint8_t type, uint8_t interval)
 	memset(&igmp, 0, sizeof(igmp));
 	igmp.igmp_type = type;
 	igmp.igmp_code = interval;
-	igmp.igmp_cksum = in_cksum((uint16_t *)&igmp, sizeof(igmp) / 2);
+	igmp.igmp_cksum = in_cksum(&igmp, sizeof(igmp));
 
 	compose_addr((struct sockaddr_in *)&dest, MC_ALL_ROUTERS);
 
@@ -0,0 +1,135 @@
+/* Shared memory statistics
+ *
+ * Copyright (c) 2017-2021  Joachim Wiberg <troglobit@gmail.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <config.h>
+#include <err.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+
+#include "stats.h"
+
+struct stats *stats;
+static size_t stats_len;
+static const char *stats_path;
+static int stats_fd = -1;
+
+/*
+ * The lock is held for as long as we run, so a second instance using
+ * the same path backs off instead of truncating a live file.
+ */
+static struct stats *stats_map(const char *path)
+{
+	struct stats *shm;
+	int fd;
+
+	fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+	if (fd < 0) {
+		warn("Cannot create %s, statistics not available", path);
+		return NULL;
+	}
+
+	if (flock(fd, LOCK_EX | LOCK_NB)) {
+		warnx("%s in use by another mrdisc, statistics not available", path);
+		close(fd);
+		return NULL;
+	}
+
+	if (ftruncate(fd, 0) || ftruncate(fd, stats_len)) {
+		warn("Cannot size %s, statistics not available", path);
+		goto fail;
+	}
+
+	shm = mmap(NULL, stats_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (shm == MAP_FAILED) {
+		warn("Cannot map %s, statistics not available", path);
+		goto fail;
+	}
+
+	stats_fd   = fd;
+	stats_path = path;
+	return shm;
+fail:
+	unlink(path);
+	close(fd);
+	return NULL;
+}
+
+/*
+ * Set up statistics for num interface entries, in the mapped file if
+ * possible.  Otherwise the counters are kept in private memory, so the
+ * rest of the daemon never has to check.
+ */
+int stats_init(const char *path, int num, uint8_t interval)
+{
+	stats_len = sizeof(*stats) + num * sizeof(struct ifstats);
+
+	stats = stats_map(path);
+	if (!stats) {
+		stats = calloc(1, stats_len);
+		if (!stats)
+			err(1, "Failed allocating statistics");
+	}
+
+	stats->version  = STATS_VERSION;
+	stats->pid      = getpid();
+	stats->interval = interval;
+	stats->ifmax    = num;
+	__atomic_store_n(&stats->magic, STATS_MAGIC, __ATOMIC_RELEASE);
+
+	return stats_path ? 0 : -1;
+}
+
+void stats_exit(void)
+{
+	if (!stats_path) {
+		free(stats);
+		return;
+	}
+
+	munmap(stats, stats_len);
+	unlink(stats_path);
+	close(stats_fd);
+}
+
+/* Allocate a per-interface entry, always succeeds */
+struct ifstats *stats_iface(char *ifname, int af)
+{
+	struct ifstats *st;
+
+	if (stats->ifnum >= stats->ifmax)
+		errx(1, "Too many interfaces for statistics");
+
+	stats_begin();
+	st = &stats->iface[stats->ifnum++];
+	snprintf(st->ifname, sizeof(st->ifname), "%s", ifname);
+	st->af = af;
+	stats_end();
+
+	return st;
+}
+
+/**
+ * Local Variables:
+ *  indent-tabs-mode: t
+ *  c-file-style: "linux"
+ * End:
+ */
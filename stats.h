@@ -0,0 +1,76 @@
+#define STATS_PATH           "/run/mrdisc.stats"
+#define STATS_MAGIC          0x4d524453	/* "MRDS" */
+#define STATS_VERSION        1
+
+/*
+ * Layout of the memory mapped statistics file.  There is one writer,
+ * the daemon, which bumps seq to an odd value before an update and to
+ * an even value after.  Keep the odd window to plain stores, never I/O,
+ * use stats_inc() and stats_set().  Readers copy the page and retry if
+ * seq was odd or changed during the copy, see stats_snapshot().
+ */
+struct ifstats {
+	char     ifname[16];	/* IFNAMSIZ */
+	uint32_t af;
+	uint32_t drops;		/* Kernel receive queue drops */
+	uint64_t sent;
+	uint64_t received;
+	uint64_t solicits;
+	uint64_t failures;
+};
+
+struct stats {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t seq;
+	uint32_t pid;
+	uint32_t interval;
+	uint32_t ifnum;		/* Entries in use */
+	uint32_t ifmax;		/* Entries allocated */
+	uint32_t reserved;
+	uint64_t next;		/* Next announcement, CLOCK_MONOTONIC ms */
+	uint64_t misses;	/* Missed announcement deadlines */
+	struct ifstats iface[];
+};
+
+#ifdef ENABLE_STATS
+extern struct stats *stats;
+
+int             stats_init  (const char *path, int num, uint8_t interval);
+void            stats_exit  (void);
+struct ifstats *stats_iface (char *ifname, int af);
+
+static inline void stats_begin(void)
+{
+	__atomic_store_n(&stats->seq, stats->seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void stats_end(void)
+{
+	__atomic_store_n(&stats->seq, stats->seq + 1, __ATOMIC_RELEASE);
+}
+
+static inline void stats_deadline(uint64_t next, uint64_t misses)
+{
+	stats_begin();
+	stats->next   = next;
+	stats->misses = misses;
+	stats_end();
+}
+
+#define stats_inc(st, field)						\
+	do { stats_begin(); (st)->field++; stats_end(); } while (0)
+#define stats_set(st, field, val)					\
+	do { stats_begin(); (st)->field = (val); stats_end(); } while (0)
+#else
+static inline int             stats_init  (const char *path, int num, uint8_t interval) { return 0; }
+static inline void            stats_exit  (void) { }
+static inline struct ifstats *stats_iface (char *ifname, int af) { return NULL; }
+static inline void            stats_begin (void) { }
+static inline void            stats_end   (void) { }
+static inline void            stats_deadline (uint64_t next, uint64_t misses) { }
+
+#define stats_inc(st, field)      do { } while (0)
+#define stats_set(st, field, val) do { } while (0)
+#endif
@@ -0,0 +1,73 @@
+/* Throughput of in_cksum() for a few typical buffer sizes
+ *
+ * Copyright (c) 2017-2021  Joachim Wiberg <troglobit@gmail.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define TOTAL  (256 * 1024 * 1024)	/* Bytes summed per size */
+
+uint16_t in_cksum(const void *buf, size_t len);
+uint16_t in_cksum_update(uint16_t cksum, uint16_t old, uint16_t new);
+uint64_t now_ms(void);
+
+int main(void)
+{
+	static const size_t sizes[] = { 8, 64, 1500, 9000, 65536 };
+	volatile uint16_t sink = 0;
+	uint64_t start, ms;
+	uint8_t *buf;
+	size_t i, n, iter;
+
+	buf = malloc(65536);
+	if (!buf)
+		return 1;
+	for (i = 0; i < 65536; i++)
+		buf[i] = rand();
+
+	printf("%8s %12s %10s\n", "BYTES", "CALLS/s", "MiB/s");
+	for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		iter  = TOTAL / sizes[i];
+		start = now_ms();
+		for (n = 0; n < iter; n++)
+			sink += in_cksum(buf, sizes[i]);
+		ms = now_ms() - start;
+		if (!ms)
+			ms = 1;
+
+		printf("%8zu %12.0f %10.1f\n", sizes[i], iter * 1000.0 / ms,
+		       TOTAL / 1048576.0 * 1000.0 / ms);
+	}
+
+	iter  = 100000000;
+	start = now_ms();
+	for (n = 0; n < iter; n++)
+		sink = in_cksum_update(sink, n, n + 1);
+	ms = now_ms() - start;
+	printf("\nin_cksum_update(): %.0f calls/s\n", iter * 1000.0 / (ms ? ms : 1));
+
+	free(buf);
+
+	return 0;
+}
+
+/**
+ * Local Variables:
+ *  indent-tabs-mode: t
+ *  c-file-style: "linux"
+ * End:
+ */
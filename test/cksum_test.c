@@ -0,0 +1,154 @@
+/* Verify in_cksum() and in_cksum_update() against a byte-wise reference
+ *
+ * Copyright (c) 2017-2021  Joachim Wiberg <troglobit@gmail.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_LEN  65536
+
+uint16_t in_cksum(const void *buf, size_t len);
+uint16_t in_cksum_update(uint16_t cksum, uint16_t old, uint16_t new);
+
+/* RFC 1071, one big-endian 16-bit word at a time, odd byte zero padded */
+static uint16_t ref_cksum(const uint8_t *p, size_t len)
+{
+	uint32_t sum = 0;
+	size_t i;
+
+	for (i = 0; i + 1 < len; i += 2)
+		sum += (p[i] << 8) | p[i + 1];
+	if (len & 1)
+		sum += p[len - 1] << 8;
+
+	while (sum >> 16)
+		sum = (sum & 0xffff) + (sum >> 16);
+
+	return htons(~sum & 0xffff);
+}
+
+/* 0x0000 and 0xffff are both zero in one's complement */
+static int same(uint16_t a, uint16_t b)
+{
+	return a == b || ((a == 0 || a == 0xffff) && (b == 0 || b == 0xffff));
+}
+
+static void fill(uint8_t *buf, size_t len, int pattern)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		switch (pattern) {
+		case 0:
+			buf[i] = 0x00;
+			break;
+		case 1:
+			buf[i] = 0xff;	/* Worst case for carries */
+			break;
+		default:
+			buf[i] = rand();
+			break;
+		}
+	}
+}
+
+static int test_full(uint8_t *buf)
+{
+	static const size_t big[] = { 1499, 1500, 4096, 9001, 32768, 65535, MAX_LEN };
+	int fail = 0, pattern;
+	size_t len, off, i;
+
+	for (pattern = 0; pattern < 3; pattern++) {
+		/* Every short length, at every alignment */
+		for (off = 0; off < 4; off++) {
+			for (len = 0; len <= 256; len++) {
+				fill(buf + off, len, pattern);
+				if (in_cksum(buf + off, len) != ref_cksum(buf + off, len)) {
+					printf("in_cksum() mismatch, len %zu offset %zu pattern %d\n",
+					       len, off, pattern);
+					fail++;
+				}
+			}
+		}
+
+		for (i = 0; i < sizeof(big) / sizeof(big[0]); i++) {
+			len = big[i];
+			fill(buf + 1, len - 1, pattern);
+			fill(buf, len, pattern);
+			if (in_cksum(buf, len) != ref_cksum(buf, len) ||
+			    in_cksum(buf + 1, len - 1) != ref_cksum(buf + 1, len - 1)) {
+				printf("in_cksum() mismatch, len %zu pattern %d\n", len, pattern);
+				fail++;
+			}
+		}
+	}
+
+	return fail;
+}
+
+static int test_update(uint8_t *buf)
+{
+	uint16_t cksum, old, new;
+	size_t len, pos;
+	int fail = 0, i;
+
+	for (i = 0; i < 100000; i++) {
+		len = 2 + 2 * (rand() % 32);
+		pos = 2 * (rand() % (len / 2));
+		fill(buf, len, i % 100 ? 2 : 1);
+
+		cksum = in_cksum(buf, len);
+		memcpy(&old, buf + pos, sizeof(old));
+		new = rand();
+		memcpy(buf + pos, &new, sizeof(new));
+
+		if (!same(in_cksum_update(cksum, old, new), in_cksum(buf, len))) {
+			printf("in_cksum_update() mismatch, len %zu pos %zu\n", len, pos);
+			fail++;
+		}
+	}
+
+	return fail;
+}
+
+int main(void)
+{
+	uint8_t *buf;
+	int fail;
+
+	buf = malloc(MAX_LEN + 4);
+	if (!buf)
+		return 1;
+
+	srand(4286);
+	fail  = test_full(buf);
+	fail += test_update(buf);
+	free(buf);
+
+	printf("%s: %d failures\n", fail ? "FAIL" : "PASS", fail);
+
+	return fail ? 1 : 0;
+}
+
+/**
+ * Local Variables:
+ *  indent-tabs-mode: t
+ *  c-file-style: "linux"
+ * End:
+ */
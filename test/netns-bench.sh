@@ -0,0 +1,197 @@
+#!/bin/sh
+# Router port convergence benchmark, a snooping bridge in one network
+# namespace with NUM veth ports to mrdisc in another.  Reports how long
+# the bridge takes to learn all ports as router ports after startup, a
+# restart, a link flap, and a solicitation, and how accurately the
+# announcements follow the interval.  Must be run as root.
+#
+# Network namespaces do not isolate the filesystem, so the stats file
+# and event socket are put in a temp dir, not in /run.
+BIN=${1:-./mrdisc}
+SOLICIT=${SOLICIT:-$(dirname "$BIN")/solicit}
+NUM=${NUM:-"1 10 100"}
+INTERVAL=${INTERVAL:-4}
+ROUNDS=${ROUNDS:-3}
+BR=mrdisc-br$$
+RTR=mrdisc-rtr$$
+PID=
+
+skip()
+{
+	echo "SKIP: $*"
+	exit 77
+}
+
+now()
+{
+	echo $(( $(date +%s%N) / 1000000 ))
+}
+
+learned()
+{
+	bridge -n $BR -d mdb show | awk '/^router ports on/ {
+		for (i = 5; i <= NF; i++)
+			if ($i ~ /^rtr[0-9]+$/)
+				n++
+	} END { print n + 0 }'
+}
+
+# Wait for all ports to be router ports, print time since $1
+converge()
+{
+	limit=$(( $1 + (3 * INTERVAL + 5) * 1000 ))
+	while [ "$(learned)" -lt $n ]; do
+		if [ "$(now)" -gt $limit ]; then
+			echo "timeout"
+			return
+		fi
+		sleep 0.01
+	done
+	echo "$(( $(now) - $1 )) ms"
+}
+
+# Drop learned router ports, setting mcast_router back to 1 relearns
+forget()
+{
+	for i in $(seq 0 $((n - 1))); do
+		echo "link set dev rtr$i mcast_router 0"
+		echo "link set dev rtr$i mcast_router 1"
+	done | bridge -n $BR -batch -
+}
+
+links()
+{
+	for i in $(seq 0 $((n - 1))); do
+		echo "link set veth$i $1"
+	done | ip -n $RTR -batch -
+}
+
+# Carrier changes are batched by the kernel, wait until all are up
+wait_up()
+{
+	while [ "$(ip -n $BR -o link show | grep -c 'rtr[0-9]*@.*state UP')" -lt $n ]; do
+		sleep 0.1
+	done
+}
+
+setup()
+{
+	ip netns add $BR
+	ip netns add $RTR
+	ip -n $BR link add br0 type bridge mcast_snooping 1
+	for i in $(seq 0 $((n - 1))); do
+		echo "link add veth$i netns $RTR type veth peer name rtr$i netns $BR"
+	done | ip -batch -
+	for i in $(seq 0 $((n - 1))); do
+		echo "link set rtr$i master br0 up"
+	done | ip -n $BR -batch -
+	# Isolated ports only talk to the bridge, otherwise every frame
+	# is flooded back to mrdisc on all other ports, O(n^2) per round
+	for i in $(seq 0 $((n - 1))); do
+		echo "link set dev rtr$i isolated on"
+	done | bridge -n $BR -batch -
+	links up
+	ip -n $BR link set br0 up
+	wait_up
+	IFACES=$(seq -f "veth%g" 0 $((n - 1)))
+}
+
+teardown()
+{
+	stop
+	ip netns del $BR
+	ip netns del $RTR
+} 2>/dev/null
+
+start()
+{
+	ip netns exec $RTR $BIN -4 -i $INTERVAL $OPTS $IFACES >/dev/null 2>&1 &
+	PID=$!
+}
+
+stop()
+{
+	[ -n "$PID" ] || return
+	kill $PID
+	wait $PID
+	PID=
+}
+
+# Announcement lateness relative to the previous one, on the last
+# interface, which is also the last one to be sent to
+accuracy()
+{
+	[ -S "$TMP/mrdisc.sock" ]     || { echo "n/a"; return; }
+	command -v python3 >/dev/null || { echo "n/a"; return; }
+	python3 - "$TMP/mrdisc.sock" veth$((n - 1)) $INTERVAL $ROUNDS <<-'PY'
+	import json, socket, sys
+	path, iface, interval, rounds = sys.argv[1], sys.argv[2], int(sys.argv[3]), int(sys.argv[4])
+	s = socket.socket(socket.AF_UNIX)
+	s.connect(path)
+	s.settimeout(interval * 2 + 1)
+	buf, stamps = b"", []
+	try:
+	    while len(stamps) <= rounds:
+	        buf += s.recv(65536)
+	        *lines, buf = buf.split(b"\n")
+	        for line in lines:
+	            ev = json.loads(line)
+	            if ev.get("event") == "announce" and ev.get("iface") == iface:
+	                stamps.append(ev["time"])
+	except socket.timeout:
+	    pass
+	late = [abs((b - a) * 1000 - interval * 1000) for a, b in zip(stamps, stamps[1:])]
+	print("avg %.0f/max %.0f ms" % (sum(late) / len(late), max(late)) if late else "timeout")
+	PY
+}
+
+[ "$(id -u)" = "0" ]          || skip "not root"
+command -v ip     >/dev/null || skip "ip(8) missing"
+command -v bridge >/dev/null || skip "bridge(8) missing"
+[ -x "$BIN" ]                 || skip "$BIN missing"
+$BIN -4 -h >/dev/null 2>&1    || skip "$BIN built without IPv4"
+
+TMP=$(mktemp -d)
+trap 'teardown; rm -rf "$TMP"' EXIT
+trap 'exit 1' INT TERM
+ulimit -n 4096 2>/dev/null
+
+# Only pass options for features built in, they are rejected otherwise
+OPTS=
+$BIN -h | grep -q -- "-s FILE" && OPTS="$OPTS -s $TMP/mrdisc.stats"
+$BIN -h | grep -q -- "-u SOCK" && OPTS="$OPTS -u $TMP/mrdisc.sock"
+
+printf "%7s %10s %10s %10s %10s %18s\n" IFACES STARTUP RESTART FLAP SOLICIT ANNOUNCE
+for n in $NUM; do
+	setup
+
+	t=$(now)
+	start
+	startup=$(converge $t)
+	announce=$(accuracy)
+
+	stop
+	forget
+	t=$(now)
+	start
+	restart=$(converge $t)
+
+	links down
+	forget
+	links up
+	wait_up
+	t=$(now)
+	flap=$(converge $t)
+
+	solicit="n/a"
+	if [ -x "$SOLICIT" ]; then
+		forget
+		t=$(now)
+		ip netns exec $BR $SOLICIT -4 br0
+		solicit=$(converge $t)
+	fi
+
+	printf "%7s %10s %10s %10s %10s %18s\n" $n "$startup" "$restart" \
+	       "$flap" "$solicit" "$announce"
+	teardown
+done